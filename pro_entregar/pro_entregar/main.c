@@ -16,6 +16,9 @@
 #include <float.h>
 #define PI 3.141592653589793
 
+#define ENTROPIA_NUM_BINS 32     // Número fijo de bins del histograma de amplitudes
+#define ENTROPIA_PERCENTIL 0.01  // Fracción de muestras recortada en cada extremo del rango de los bins
+
 
 // Función que evalúa si una ventana es apta para estudio
 bool es_ventana_apta(double amplitud_max, double tasa_cambio_amplitud, double entropia, double curtosis, double autocorrelacion) {
@@ -41,13 +44,13 @@ bool es_ventana_apta(double amplitud_max, double tasa_cambio_amplitud, double en
 // Prototipos de las funciones auxiliares
 double calcular_amplitud_max(double *signal, int length);
 double calcular_tasa_cambio_amplitud(double *signal, int length);
-double calcular_entropia(double *signal, int length);
+double calcular_entropia(double *signal, int length, double minimo, double maximo);
 double calcular_curtosis(double *signal, int length);
 double calcular_autocorrelacion(double *signal, int length, int lag);
 void filtro_kalman(double *input, double *output, int length);
 
 // Función para clasificar mini ondas sísmicas
-void clasificar_mini_onda_sismica(double *signal, double dominant_freq, double ancho_banda, double *espectro_frecuencias, int num_frecuencias, double frecuencia_muestreo, int duracion_evento_minima, int ventana_analisis) {
+void clasificar_mini_onda_sismica(double *signal, double dominant_freq, double ancho_banda, double *espectro_frecuencias, int num_frecuencias, double frecuencia_muestreo, int duracion_evento_minima, int ventana_analisis, double entropia_min, double entropia_max) {
     // Cálculo de umbrales fijos
     double umbral_amplitud_base = 5 * ancho_banda;
     int indice_freq_dominante = (int)(dominant_freq * num_frecuencias / (frecuencia_muestreo / 2));
@@ -63,7 +66,7 @@ void clasificar_mini_onda_sismica(double *signal, double dominant_freq, double a
     // Inicializar variables para cálculos
     double amplitud_max = calcular_amplitud_max(signal + inicio_ventana, ventana_analisis);
     double tasa_cambio_amplitud = calcular_tasa_cambio_amplitud(signal + inicio_ventana, ventana_analisis);
-    double entropia = calcular_entropia(signal + inicio_ventana, ventana_analisis);
+    double entropia = calcular_entropia(signal + inicio_ventana, ventana_analisis, entropia_min, entropia_max);
     double curtosis = calcular_curtosis(signal + inicio_ventana, ventana_analisis);
     double autocorrelacion = calcular_autocorrelacion(signal + inicio_ventana, ventana_analisis, 10);
     
@@ -211,25 +214,154 @@ double calcular_curtosis(double *signal, int LUX) {
 
     return curtosis;
 }
-//esta funcion es para clasificar_onda_ruido 02
-double calcular_entropia(double *signal, int LUX) {
-    double entropia = 0.0;
-    double total = 0.0;
-    
-    // Calcular la suma total de los valores absolutos de la señal
+// Índice del bin de una amplitud para el histograma de entropía. Los bins son fijos entre
+// minimo y maximo; lo que cae fuera va al primer o al último bin. Se recorta antes de
+// convertir a int para que ningún valor (ni un NaN) se salga del arreglo.
+static int bin_entropia(double valor, double minimo, double maximo) {
+    if (!(maximo > minimo)) {
+        return 0; // Rango vacío: todo en un solo bin
+    }
+    // Dividir primero por el rango para que la escala no se desborde con rangos diminutos
+    double posicion = (valor - minimo) / (maximo - minimo) * ENTROPIA_NUM_BINS;
+    if (!(posicion > 0.0)) posicion = 0.0;
+    if (posicion > ENTROPIA_NUM_BINS - 1) posicion = ENTROPIA_NUM_BINS - 1;
+    return (int)posicion;
+}
+
+static int comparar_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Límites de los bins de entropía para toda una señal: los percentiles ENTROPIA_PERCENTIL
+// y 1 - ENTROPIA_PERCENTIL de sus muestras finitas, así un evento corto y grande no
+// aplasta al resto de las ventanas en uno o dos bins. Devuelve false si falta memoria.
+bool calcular_rango_entropia(double *signal, int LUX, double *minimo, double *maximo) {
+    *minimo = 0.0;
+    *maximo = 0.0;
+
+    double *ordenada = (double *)malloc(LUX * sizeof(double));
+    if (ordenada == NULL) {
+        return false;
+    }
+    int n = 0;
     for (int i = 0; i < LUX; i++) {
-        total += fabs(signal[i]);
+        if (isfinite(signal[i])) {
+            ordenada[n++] = signal[i];
+        }
     }
-    
-    // Calcular la entropía
+
+    if (n > 0) {
+        qsort(ordenada, n, sizeof(double), comparar_double);
+        int recorte = (int)(ENTROPIA_PERCENTIL * (n - 1));
+        *minimo = ordenada[recorte];
+        *maximo = ordenada[n - 1 - recorte];
+    }
+    free(ordenada);
+    return true;
+}
+
+//esta funcion es para clasificar_onda_ruido 02
+// Entropía de Shannon (en nats) del histograma de amplitudes de la ventana, con
+// ENTROPIA_NUM_BINS bins fijos entre minimo y maximo (ver calcular_rango_entropia).
+// Está acotada por log(ENTROPIA_NUM_BINS) y no crece con el largo de la ventana.
+// Devuelve NAN si alguna muestra es NaN o infinita.
+double calcular_entropia(double *signal, int LUX, double minimo, double maximo) {
+    if (LUX <= 0) {
+        return 0.0;
+    }
+
+    // Llenar el histograma
+    double conteo[ENTROPIA_NUM_BINS] = {0};
     for (int i = 0; i < LUX; i++) {
-        double p = fabs(signal[i]) / total;
-        if (p > 0) {
-            entropia -= p * log(p);
+        if (!isfinite(signal[i])) {
+            return NAN; // Una muestra NaN o infinita no tiene bin
         }
+        conteo[bin_entropia(signal[i], minimo, maximo)] += 1.0;
     }
-    
-    return entropia;
+
+    // H = log(N) - (1/N) * sum(c * log(c)): un log por bin, no por muestra
+    double suma_nlogn = 0.0;
+    for (int b = 0; b < ENTROPIA_NUM_BINS; b++) {
+        if (conteo[b] > 0) {
+            suma_nlogn += conteo[b] * log(conteo[b]);
+        }
+    }
+    return log((double)LUX) - suma_nlogn / LUX;
+}
+
+// Histograma de entropía que se actualiza muestra a muestra al deslizar la ventana.
+// Usa los mismos bins que calcular_entropia, y n*log(n) sale de una tabla, así que
+// agregar o quitar una muestra no llama a log.
+typedef struct {
+    int conteo[ENTROPIA_NUM_BINS];
+    int total;              // Muestras dentro de la ventana
+    int no_finitas;         // Muestras NaN o infinitas dentro de la ventana
+    double minimo;          // Límites de los bins
+    double maximo;
+    double suma_nlogn;      // sum(c * log(c)) sobre todos los bins
+    double *tabla_nlogn;    // n * log(n) para n = 0..capacidad
+    int capacidad;          // Máximo de muestras en la ventana
+} HistogramaEntropia;
+
+// Prepara el histograma; devuelve false si no se pudo asignar memoria
+bool histograma_entropia_iniciar(HistogramaEntropia *h, double minimo, double maximo, int capacidad) {
+    memset(h->conteo, 0, sizeof(h->conteo));
+    h->total = 0;
+    h->no_finitas = 0;
+    h->minimo = minimo;
+    h->maximo = maximo;
+    h->suma_nlogn = 0.0;
+    h->capacidad = capacidad;
+
+    h->tabla_nlogn = (double *)malloc((capacidad + 1) * sizeof(double));
+    if (h->tabla_nlogn == NULL) {
+        return false;
+    }
+    h->tabla_nlogn[0] = 0.0;
+    for (int n = 1; n <= capacidad; n++) {
+        h->tabla_nlogn[n] = n * log((double)n);
+    }
+    return true;
+}
+
+void histograma_entropia_liberar(HistogramaEntropia *h) {
+    free(h->tabla_nlogn);
+    h->tabla_nlogn = NULL;
+}
+
+// Agrega una muestra que entra a la ventana
+void histograma_entropia_agregar(HistogramaEntropia *h, double valor) {
+    h->total++;
+    if (!isfinite(valor)) {
+        h->no_finitas++;
+        return;
+    }
+    int c = h->conteo[bin_entropia(valor, h->minimo, h->maximo)]++;
+    h->suma_nlogn += h->tabla_nlogn[c + 1] - h->tabla_nlogn[c];
+}
+
+// Quita una muestra que sale de la ventana
+void histograma_entropia_quitar(HistogramaEntropia *h, double valor) {
+    h->total--;
+    if (!isfinite(valor)) {
+        h->no_finitas--;
+        return;
+    }
+    int c = h->conteo[bin_entropia(valor, h->minimo, h->maximo)]--;
+    h->suma_nlogn += h->tabla_nlogn[c - 1] - h->tabla_nlogn[c];
+}
+
+// Entropía (en nats) de las muestras que hay ahora en la ventana; igual a calcular_entropia
+double histograma_entropia_valor(const HistogramaEntropia *h) {
+    if (h->no_finitas > 0) {
+        return NAN;
+    }
+    if (h->total <= 0) {
+        return 0.0;
+    }
+    // log(N) = (N * log(N)) / N, también sale de la tabla
+    return (h->tabla_nlogn[h->total] - h->suma_nlogn) / h->total;
 }
 
 //esta funcion es para clasificar_onda_ruido 04
@@ -338,7 +470,7 @@ double calcular_SNR(double *signal, int length, double noise_threshold) {
 
 
 // Función para clasificar ondas de ruido
-void clasificar_onda_ruido(double *signal, double dominant_freq, double ancho_banda, double *espectro_frecuencias, int num_frecuencias, double frecuencia_muestreo, int duracion_evento_minima, int ventana_analisis) {
+void clasificar_onda_ruido(double *signal, double dominant_freq, double ancho_banda, double *espectro_frecuencias, int num_frecuencias, double frecuencia_muestreo, int duracion_evento_minima, int ventana_analisis, double entropia_min, double entropia_max) {
     // Cálculo de umbrales fijos
     double umbral_amplitud_base = 5 * ancho_banda;
     int indice_freq_dominante = (int)(dominant_freq * num_frecuencias / (frecuencia_muestreo / 2));
@@ -354,7 +486,7 @@ void clasificar_onda_ruido(double *signal, double dominant_freq, double ancho_ba
     // Inicializar variables para cálculos
     double amplitud_max = calcular_amplitud_max(signal + inicio_ventana, ventana_analisis);
     double tasa_cambio_amplitud = calcular_tasa_cambio_amplitud(signal + inicio_ventana, ventana_analisis);
-    double entropia = calcular_entropia(signal + inicio_ventana, ventana_analisis);
+    double entropia = calcular_entropia(signal + inicio_ventana, ventana_analisis, entropia_min, entropia_max);
     double curtosis = calcular_curtosis(signal + inicio_ventana, ventana_analisis);
     double autocorrelacion = calcular_autocorrelacion(signal + inicio_ventana, ventana_analisis, 10);
     
@@ -487,7 +619,12 @@ void filtro_paso_bajo(double *signal, double *output, int length, double cutoff)
 
 // Define tus funciones previamente aquí, incluyendo las funciones de análisis.
 
-void procesar_archivo_csv(const char *archivo) {
+void procesar_archivo_csv(const char *archivo, int ventana_analisis, int paso_ventana) {
+    if (ventana_analisis <= 0 || paso_ventana <= 0) {
+        fprintf(stderr, "Error: la ventana y el paso deben ser positivos\n");
+        return;
+    }
+
     printf("Intentando abrir el archivo: %s\n", archivo);
     FILE *fp = fopen(archivo, "r");
     if (!fp) {
@@ -534,6 +671,15 @@ void procesar_archivo_csv(const char *archivo) {
     filtro_paso_bajo(data, filtered_data, LUX, 0.1);  // Cutoff de 0.1 (ajusta según sea necesario)
     printf("Filtro de paso bajo aplicado.\n");
 
+    // Límites fijos de los bins de entropía, los mismos para toda la señal
+    double entropia_min = 0.0, entropia_max = 0.0;
+    if (!calcular_rango_entropia(filtered_data, LUX, &entropia_min, &entropia_max)) {
+        fprintf(stderr, "Error al asignar memoria para el rango de entropía\n");
+        free(data);
+        free(filtered_data);
+        return;
+    }
+
     // **2. Ajustar umbrales dinámicos de amplitud y tasa de cambio de amplitud**
     double amplitud_threshold = 0.0;
     double amplitud_rate_threshold = 0.0;
@@ -541,7 +687,6 @@ void procesar_archivo_csv(const char *archivo) {
     printf("Umbrales ajustados: Amplitud: %f, Tasa de cambio de amplitud: %f\n", amplitud_threshold, amplitud_rate_threshold);
 
     // **3. Definir parámetros para el análisis de mini ventanas**
-    int ventana_analisis = 1024; // Tamaño de cada mini ventana
     int max_desplazamiento = 10;  // Desplazamiento máximo para autocorrelación
 
     
@@ -584,14 +729,38 @@ void procesar_archivo_csv(const char *archivo) {
     double *magnitudes = espectro_real;
 
     // Usar las magnitudes en la función clasificar_onda_ruido
-    clasificar_onda_ruido(filtered_data, dominant_freq, ancho_banda, magnitudes, LUX / 2 + 1, sampling_rate, 50, 20);
+    clasificar_onda_ruido(filtered_data, dominant_freq, ancho_banda, magnitudes, LUX / 2 + 1, sampling_rate, 50, 20, entropia_min, entropia_max);
     
+    // Histograma de entropía que se desliza junto con la ventana
+    HistogramaEntropia histograma;
+    if (!histograma_entropia_iniciar(&histograma, entropia_min, entropia_max, ventana_analisis)) {
+        fprintf(stderr, "Error al asignar memoria para el histograma de entropía\n");
+        free(espectro_real);
+        free(frecuencias);
+        fftw_destroy_plan(plan);
+        fftw_free(espectro);
+        free(data);
+        free(filtered_data);
+        return;
+    }
+    int inicio_anterior = 0, fin_anterior = 0; // Muestras que hay ahora en el histograma
+
     // Variables para almacenar resultados
     int ventanas_aptas = 0;  // Contador de ventanas aptas
     // Aplicar análisis de mini ventanas
-    for (int i = 0; i < LUX; i += ventana_analisis) {
+    for (int i = 0; i < LUX; i += paso_ventana) {
         int ventana_length = fmin(ventana_analisis, LUX - i); // Asegúrate de que no te salgas del arreglo
 
+        // Deslizar el histograma: quitar las muestras que salen y agregar las que entran
+        for (int j = inicio_anterior; j < fin_anterior && j < i; j++) {
+            histograma_entropia_quitar(&histograma, filtered_data[j]);
+        }
+        for (int j = (fin_anterior > i ? fin_anterior : i); j < i + ventana_length; j++) {
+            histograma_entropia_agregar(&histograma, filtered_data[j]);
+        }
+        inicio_anterior = i;
+        fin_anterior = i + ventana_length;
+
         // Crear una ventana temporal
         double *ventana = (double *)malloc(ventana_length * sizeof(double));
         memcpy(ventana, filtered_data + i, ventana_length * sizeof(double));
@@ -599,12 +768,12 @@ void procesar_archivo_csv(const char *archivo) {
         // Llamar a funciones de análisis sobre la ventana
         double amplitud_max = calcular_amplitud_max(ventana, ventana_length);
         double tasa_cambio_amplitud = calcular_tasa_cambio_amplitud(ventana, ventana_length);
-        double entropia = calcular_entropia(ventana, ventana_length);
+        double entropia = histograma_entropia_valor(&histograma);
         double curtosis = calcular_curtosis(ventana, ventana_length);
         double autocorrelacion = calcular_autocorrelacion(ventana, ventana_length, max_desplazamiento);
         
         // Imprimir valores calculados para cada ventana
-        printf("Ventana %d:\n", i / ventana_analisis);
+        printf("Ventana %d:\n", i / paso_ventana);
         printf("  Amplitud Max: %lf\n", amplitud_max);
         printf("  Tasa de Cambio de Amplitud: %lf\n", tasa_cambio_amplitud);
         printf("  Entropía: %lf\n", entropia);
@@ -614,15 +783,16 @@ void procesar_archivo_csv(const char *archivo) {
         // Evaluar si la ventana es apta
                // bool apta = es_ventana_apta(amplitud_max, tasa_cambio_amplitud, entropia, curtosis, autocorrelacion);
                 //if (apta) {
-                  //  printf("Ventana %d es apta para estudio más detallado.\n", i / ventana_analisis);
+                  //  printf("Ventana %d es apta para estudio más detallado.\n", i / paso_ventana);
                     //ventanas_aptas++;  // Aumentar el contador de ventanas aptas
                 //} else {
-                  //  printf("Ventana %d no es apta.\n", i / ventana_analisis);
+                  //  printf("Ventana %d no es apta.\n", i / paso_ventana);
                 //}        // Liberar la ventana
         free(ventana);
     }
 
     // Liberar la memoria correctamente
+    histograma_entropia_liberar(&histograma);
     free(espectro_real);  // Esto también libera 'magnitudes', ya que es lo mismo
     free(frecuencias);
     fftw_destroy_plan(plan);
@@ -634,6 +804,8 @@ void procesar_archivo_csv(const char *archivo) {
 
 int main(void) {//00
     char carpeta[100];
+    int ventana_analisis = 1024; // Tamaño de cada mini ventana
+    int paso_ventana = 512;      // Avance entre ventanas; menor que la ventana = ventanas solapadas
     DIR *dir;
     struct dirent *ent;
 
@@ -649,7 +821,7 @@ int main(void) {//00
         if (strstr(ent->d_name, ".csv") != NULL) {
             char archivo[200];
             sprintf(archivo, "%s/%s", carpeta, ent->d_name);
-            procesar_archivo_csv(archivo);
+            procesar_archivo_csv(archivo, ventana_analisis, paso_ventana);
         }
     }
 